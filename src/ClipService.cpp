@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2020 Owen Osborn, Critter & Gutiari, Inc.
+ *
+ * BSD Simplified License.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ *
+ */
+#include "ClipService.h"
+#include "LuaHostApi.h"
+
+//--------------------------------------------------------------
+ClipService::ClipService() {
+  nextUpload = 0;
+}
+
+//--------------------------------------------------------------
+ClipService::~ClipService() {
+  releaseAll();
+}
+
+//--------------------------------------------------------------
+void ClipService::update(float bpm) {
+  float now = ofGetElapsedTimef();
+  for (auto& clip : clips) {
+    if (!clip || clip->clipBpm <= 0 || bpm <= 0) {
+      continue;
+    }
+
+    // the clock BPM jitters on every tick, follow it slowly and in 1% steps
+    clip->smoothedBpm = clip->smoothedBpm > 0 ? ofLerp(clip->smoothedBpm, bpm, 0.05f) : bpm;
+    float rate = clip->rate * clip->smoothedBpm / clip->clipBpm;
+    rate = ofClamp(roundf(rate * 100) / 100, CLIP_MIN_RATE, CLIP_MAX_RATE);
+
+    // setSpeed() is a flushing seek in gstreamer, only do it for real tempo
+    // changes and not more than once per CLIP_RATE_INTERVAL
+    float current = clip->player.getSpeed();
+    if (fabs(rate - current) > fabs(current) * CLIP_RATE_TOLERANCE &&
+        now - clip->lastRateChange >= CLIP_RATE_INTERVAL) {
+      clip->player.setSpeed(rate);
+      clip->lastRateChange = now;
+    }
+  }
+
+  // bounded uploads per frame, round robin so one clip can't starve the rest
+  int uploads = 0;
+  for (size_t i = 0; i < clips.size() && uploads < CLIP_UPLOADS_PER_FRAME; i++) {
+    Clip* clip = clips[(nextUpload + i) % clips.size()].get();
+    if (clip && clip->upload()) {
+      uploads++;
+    }
+  }
+  if (!clips.empty()) {
+    nextUpload = (nextUpload + 1) % clips.size();
+  }
+}
+
+//--------------------------------------------------------------
+int ClipService::load(const string& path) {
+  unique_ptr<Clip> clip(new Clip());
+  clip->rate = 1.0f;
+  clip->clipBpm = 0.0f;
+  clip->smoothedBpm = 0.0f;
+  clip->lastRateChange = -CLIP_RATE_INTERVAL;
+  clip->ringHead = 0;
+  clip->ringCount = 0;
+  clip->dropped = 0;
+  clip->decoded = 0;
+  clip->latencyMillis = 0.0f;
+  clip->uploaded = 0;
+  clip->latencyTotal = 0.0;
+  clip->latencyMax = 0.0f;
+
+  // decode on the gstreamer streaming thread, frames arrive via bufferEvent
+  clip->player.setThreadAppSink(true);
+  clip->player.setPixelFormat(OF_PIXELS_RGB);
+  ofAddListener(clip->player.getGstVideoUtils()->bufferEvent, clip.get(), &Clip::onBuffer);
+
+  // relative paths are relative to the mode folder, lua runs from there
+  if (!clip->player.load(ofFilePath::getAbsolutePath(path, false))) {
+    ofLogWarning("CLIP") << "could not load " << path;
+    close(clip.get());
+    return 0;
+  }
+  clip->player.setLoopState(OF_LOOP_NORMAL);
+  clip->player.play();
+
+  clips.push_back(std::move(clip));
+  return clips.size();
+}
+
+//--------------------------------------------------------------
+void ClipService::release(int handle) {
+  Clip* clip = get(handle);
+  if (clip) {
+    close(clip);
+    clips[handle - 1].reset();
+  }
+}
+
+//--------------------------------------------------------------
+void ClipService::releaseAll() {
+  for (auto& clip : clips) {
+    if (clip) {
+      close(clip.get());
+    }
+  }
+  clips.clear();
+  nextUpload = 0;
+}
+
+//--------------------------------------------------------------
+void ClipService::close(Clip* clip) {
+  ofRemoveListener(clip->player.getGstVideoUtils()->bufferEvent, clip, &Clip::onBuffer);
+  clip->player.close();
+}
+
+//--------------------------------------------------------------
+ClipService::Clip* ClipService::get(int handle) {
+  if (handle < 1 || handle > (int)clips.size()) {
+    return nullptr;
+  }
+  return clips[handle - 1].get();
+}
+
+//--------------------------------------------------------------
+void ClipService::play(int handle) {
+  Clip* clip = get(handle);
+  if (clip) {
+    clip->player.setPaused(false);
+  }
+}
+
+//--------------------------------------------------------------
+void ClipService::pause(int handle) {
+  Clip* clip = get(handle);
+  if (clip) {
+    clip->player.setPaused(true);
+  }
+}
+
+//--------------------------------------------------------------
+void ClipService::seek(int handle, float position) {
+  Clip* clip = get(handle);
+  if (clip) {
+    clip->player.setPosition(ofClamp(position, 0.0f, 1.0f));
+  }
+}
+
+//--------------------------------------------------------------
+void ClipService::setLoop(int handle, bool loop) {
+  Clip* clip = get(handle);
+  if (clip) {
+    clip->player.setLoopState(loop ? OF_LOOP_NORMAL : OF_LOOP_NONE);
+  }
+}
+
+//--------------------------------------------------------------
+void ClipService::setRate(int handle, float rate) {
+  Clip* clip = get(handle);
+  if (clip) {
+    clip->rate = ofClamp(rate, CLIP_MIN_RATE, CLIP_MAX_RATE);
+    if (clip->clipBpm <= 0) {
+      clip->player.setSpeed(clip->rate);
+    }
+  }
+}
+
+//--------------------------------------------------------------
+void ClipService::syncToBpm(int handle, float clipBpm) {
+  // clipBpm is the tempo the loop was rendered at, 0 turns syncing off
+  Clip* clip = get(handle);
+  if (clip) {
+    clip->clipBpm = clipBpm;
+    clip->smoothedBpm = 0.0f;
+    if (clipBpm <= 0) {
+      clip->player.setSpeed(clip->rate);
+    }
+  }
+}
+
+//--------------------------------------------------------------
+void ClipService::draw(int handle, float x, float y, float w, float h) {
+  Clip* clip = get(handle);
+  if (clip && clip->texture.isAllocated()) {
+    clip->texture.draw(x, y, w, h);
+  }
+}
+
+//--------------------------------------------------------------
+size_t ClipService::getNumClips() const {
+  size_t count = 0;
+  for (const auto& clip : clips) {
+    if (clip) {
+      count++;
+    }
+  }
+  return count;
+}
+
+//--------------------------------------------------------------
+size_t ClipService::getDroppedFrames() const {
+  size_t dropped = 0;
+  for (const auto& clip : clips) {
+    if (clip) {
+      dropped += clip->dropped;
+    }
+  }
+  return dropped;
+}
+
+//--------------------------------------------------------------
+float ClipService::getLatencyMillis() const {
+  float latency = 0.0f;
+  for (const auto& clip : clips) {
+    if (clip) {
+      latency = std::max(latency, clip->latencyMillis);
+    }
+  }
+  return latency;
+}
+
+//--------------------------------------------------------------
+size_t ClipService::getDecodedFrames() const {
+  size_t decoded = 0;
+  for (const auto& clip : clips) {
+    if (clip) {
+      decoded += clip->decoded;
+    }
+  }
+  return decoded;
+}
+
+//--------------------------------------------------------------
+size_t ClipService::getUploadedFrames() const {
+  size_t uploaded = 0;
+  for (const auto& clip : clips) {
+    if (clip) {
+      uploaded += clip->uploaded;
+    }
+  }
+  return uploaded;
+}
+
+//--------------------------------------------------------------
+float ClipService::getMeanLatencyMillis() const {
+  double total = 0.0;
+  size_t uploaded = 0;
+  for (const auto& clip : clips) {
+    if (clip) {
+      total += clip->latencyTotal;
+      uploaded += clip->uploaded;
+    }
+  }
+  return uploaded > 0 ? total / uploaded : 0.0f;
+}
+
+//--------------------------------------------------------------
+float ClipService::getMaxLatencyMillis() const {
+  float latency = 0.0f;
+  for (const auto& clip : clips) {
+    if (clip) {
+      latency = std::max(latency, clip->latencyMax);
+    }
+  }
+  return latency;
+}
+
+//--------------------------------------------------------------
+size_t ClipService::getTextureBytes() const {
+  size_t bytes = 0;
+  for (const auto& clip : clips) {
+    if (clip && clip->texture.isAllocated()) {
+      bytes += (size_t)clip->texture.getWidth() * clip->texture.getHeight() * 3;
+    }
+  }
+  return bytes;
+}
+
+//--------------------------------------------------------------
+void ClipService::Clip::onBuffer(ofPixels& pixels) {
+  // gstreamer thread: overwrite the oldest frame if the renderer fell behind
+  std::lock_guard<std::mutex> lock(ringMutex);
+  int slot = (ringHead + ringCount) % CLIP_RING_SIZE;
+  if (ringCount == CLIP_RING_SIZE) {
+    ringHead = (ringHead + 1) % CLIP_RING_SIZE;
+    dropped++;
+  } else {
+    ringCount++;
+  }
+  ring[slot].pixels.setFromPixels(pixels.getData(), pixels.getWidth(),
+                                  pixels.getHeight(), pixels.getPixelFormat());
+  ring[slot].decodedMicros = ofGetElapsedTimeMicros();
+  decoded++;
+}
+
+//--------------------------------------------------------------
+bool ClipService::Clip::upload() {
+  uint64_t decodedMicros;
+  {
+    // take the newest frame, anything older is already late
+    std::lock_guard<std::mutex> lock(ringMutex);
+    if (ringCount == 0) {
+      return false;
+    }
+    int newest = (ringHead + ringCount - 1) % CLIP_RING_SIZE;
+    dropped += ringCount - 1;
+    std::swap(staging, ring[newest].pixels);
+    decodedMicros = ring[newest].decodedMicros;
+    ringHead = 0;
+    ringCount = 0;
+  }
+
+  texture.loadData(staging);
+  float latency = (ofGetElapsedTimeMicros() - decodedMicros) / 1000.0f;
+  latencyMillis = latencyMillis * 0.9f + latency * 0.1f;
+  latencyTotal += latency;
+  latencyMax = std::max(latencyMax, latency);
+  uploaded++;
+  return true;
+}
+
+//--------------------------------------------------------------
+// Lua bindings
+//--------------------------------------------------------------
+
+// clip_load(path) -> handle, 0 on failure
+static int l_clip_load(lua_State* L) {
+  lua_pushinteger(L, luaHostSelf<ClipService>(L)->load(luaL_checkstring(L, 1)));
+  return 1;
+}
+
+// clip_release(handle)
+static int l_clip_release(lua_State* L) {
+  luaHostSelf<ClipService>(L)->release(luaL_checkinteger(L, 1));
+  return 0;
+}
+
+// clip_play(handle)
+static int l_clip_play(lua_State* L) {
+  luaHostSelf<ClipService>(L)->play(luaL_checkinteger(L, 1));
+  return 0;
+}
+
+// clip_pause(handle)
+static int l_clip_pause(lua_State* L) {
+  luaHostSelf<ClipService>(L)->pause(luaL_checkinteger(L, 1));
+  return 0;
+}
+
+// clip_seek(handle, position), position 0-1
+static int l_clip_seek(lua_State* L) {
+  luaHostSelf<ClipService>(L)->seek(luaL_checkinteger(L, 1), luaL_checknumber(L, 2));
+  return 0;
+}
+
+// clip_loop(handle, loop)
+static int l_clip_loop(lua_State* L) {
+  luaHostSelf<ClipService>(L)->setLoop(luaL_checkinteger(L, 1), lua_toboolean(L, 2));
+  return 0;
+}
+
+// clip_rate(handle, rate)
+static int l_clip_rate(lua_State* L) {
+  luaHostSelf<ClipService>(L)->setRate(luaL_checkinteger(L, 1), luaL_checknumber(L, 2));
+  return 0;
+}
+
+// clip_sync_bpm(handle, clipBpm), follows midi_bpm, 0 to stop following
+static int l_clip_sync_bpm(lua_State* L) {
+  luaHostSelf<ClipService>(L)->syncToBpm(luaL_checkinteger(L, 1), luaL_checknumber(L, 2));
+  return 0;
+}
+
+// clip_draw(handle, x, y [, width, height])
+static int l_clip_draw(lua_State* L) {
+  luaHostSelf<ClipService>(L)->draw(luaL_checkinteger(L, 1),
+                                    luaL_optnumber(L, 2, 0),
+                                    luaL_optnumber(L, 3, 0),
+                                    luaL_optnumber(L, 4, ofGetWidth()),
+                                    luaL_optnumber(L, 5, ofGetHeight()));
+  return 0;
+}
+
+//--------------------------------------------------------------
+void ClipService::bindLua(lua_State* L) {
+  luaRegisterHostFunction(L, "clip_load", l_clip_load, this);
+  luaRegisterHostFunction(L, "clip_release", l_clip_release, this);
+  luaRegisterHostFunction(L, "clip_play", l_clip_play, this);
+  luaRegisterHostFunction(L, "clip_pause", l_clip_pause, this);
+  luaRegisterHostFunction(L, "clip_seek", l_clip_seek, this);
+  luaRegisterHostFunction(L, "clip_loop", l_clip_loop, this);
+  luaRegisterHostFunction(L, "clip_rate", l_clip_rate, this);
+  luaRegisterHostFunction(L, "clip_sync_bpm", l_clip_sync_bpm, this);
+  luaRegisterHostFunction(L, "clip_draw", l_clip_draw, this);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2020 Owen Osborn, Critter & Gutiari, Inc.
+ *
+ * BSD Simplified License.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ *
+ */
+#pragma once
+
+#include "ofMain.h"
+#include "ofGstVideoPlayer.h"
+
+struct lua_State;
+
+#define CLIP_RING_SIZE 3
+#define CLIP_UPLOADS_PER_FRAME 2
+#define CLIP_MIN_RATE 0.1f
+#define CLIP_MAX_RATE 4.0f
+#define CLIP_RATE_TOLERANCE 0.03f   // relative change before we re-seek
+#define CLIP_RATE_INTERVAL 1.0f     // seconds between BPM driven rate changes
+
+// Video loops for modes to draw under or over their own content. GStreamer
+// decodes each clip on its streaming thread into a small ring of frames; the
+// render thread uploads at most CLIP_UPLOADS_PER_FRAME of them per frame.
+class ClipService {
+
+    public:
+        ClipService();
+        ~ClipService();
+
+        // call once per frame on the render thread
+        void    update(float bpm);
+
+        // handles are 1-based, 0 means the clip failed to load
+        int     load(const string& path);
+        void    release(int handle);
+        void    releaseAll();
+
+        void    play(int handle);
+        void    pause(int handle);
+        void    seek(int handle, float position);
+        void    setLoop(int handle, bool loop);
+        void    setRate(int handle, float rate);
+        void    syncToBpm(int handle, float clipBpm);
+        void    draw(int handle, float x, float y, float w, float h);
+
+        // register clip_* functions in the given lua state
+        void    bindLua(lua_State* L);
+
+        // stats
+        size_t  getNumClips() const;
+        size_t  getDroppedFrames() const;
+        float   getLatencyMillis() const;
+        size_t  getDecodedFrames() const;
+        size_t  getUploadedFrames() const;
+        float   getMeanLatencyMillis() const;
+        float   getMaxLatencyMillis() const;
+        size_t  getTextureBytes() const;
+
+    private:
+        struct Frame {
+            ofPixels    pixels;
+            uint64_t    decodedMicros;
+        };
+
+        struct Clip {
+            ofGstVideoPlayer    player;
+            float               rate;
+            float               clipBpm;
+            float               smoothedBpm;
+            float               lastRateChange;
+
+            // written by the gstreamer thread, drained by the render thread
+            std::mutex          ringMutex;
+            Frame               ring[CLIP_RING_SIZE];
+            int                 ringHead;
+            int                 ringCount;
+            std::atomic<size_t> dropped;
+            std::atomic<size_t> decoded;
+
+            // render thread only
+            ofPixels            staging;
+            ofTexture           texture;
+            float               latencyMillis;
+            size_t              uploaded;
+            double              latencyTotal;
+            float               latencyMax;
+
+            void    onBuffer(ofPixels& pixels);
+            bool    upload();
+        };
+
+        Clip*   get(int handle);
+        void    close(Clip* clip);
+
+        vector<unique_ptr<Clip>>    clips;
+        size_t                      nextUpload;
+};
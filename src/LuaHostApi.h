@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2020 Owen Osborn, Critter & Gutiari, Inc.
+ *
+ * BSD Simplified License.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ *
+ */
+#pragma once
+
+#include "ofxLua.h"
+
+// Small helpers for host services that expose plain C functions to Lua.
+// The owning service is stored as a light userdata upvalue so the same
+// function can be re-registered every time reloadScript() makes a new state.
+
+inline void luaRegisterHostFunction(lua_State* L, const char* name, lua_CFunction fn, void* self) {
+  lua_pushlightuserdata(L, self);
+  lua_pushcclosure(L, fn, 1);
+  lua_setglobal(L, name);
+}
+
+template <typename T>
+inline T* luaHostSelf(lua_State* L) {
+  return static_cast<T*>(lua_touserdata(L, lua_upvalueindex(1)));
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2020 Owen Osborn, Critter & Gutiari, Inc.
+ *
+ * BSD Simplified License.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ *
+ */
+#include "MemoryStats.h"
+#include <unistd.h>
+
+//--------------------------------------------------------------
+MemoryStats::MemoryStats() {
+  ring.resize(MEMORY_RING_SIZE);
+  head = 0;
+  count = 0;
+  lastTime = -1.0f;
+  segmentSamples = 0;
+  cycleDriven = false;
+}
+
+//--------------------------------------------------------------
+bool MemoryStats::isDue(float now) const {
+  return lastTime < 0 || now - lastTime >= 1.0f;
+}
+
+//--------------------------------------------------------------
+void MemoryStats::record(const MemorySample& sample) {
+  head = (head + 1) % MEMORY_RING_SIZE;
+  ring[head] = sample;
+  count = std::min(count + 1, (size_t)MEMORY_RING_SIZE);
+  lastTime = sample.time;
+
+  // garbage collected heaps saw-tooth, a segment's floor is what we compare
+  for (int tag = 0; tag < MEMORY_NUM_TAGS; tag++) {
+    if (segmentSamples == 0 || sample.bytes[tag] < currentFloor.bytes[tag]) {
+      currentFloor.bytes[tag] = sample.bytes[tag];
+    }
+  }
+  currentFloor.time = sample.time;
+  segmentSamples++;
+
+  if (!cycleDriven && segmentSamples >= MEMORY_RING_SIZE) {
+    endSegment();
+  }
+}
+
+//--------------------------------------------------------------
+void MemoryStats::setCycleDriven(bool driven) {
+  cycleDriven = driven;
+}
+
+//--------------------------------------------------------------
+void MemoryStats::endSegment() {
+  if (segmentSamples == 0) {
+    return;
+  }
+  segmentFloors.push_back(currentFloor);
+  segmentSamples = 0;
+
+  // keep the warm-up segment and the newest ones, fold the oldest
+  // remaining pair together so the start of the run isn't forgotten
+  if (segmentFloors.size() > MEMORY_MAX_SEGMENTS) {
+    for (int tag = 0; tag < MEMORY_NUM_TAGS; tag++) {
+      segmentFloors[1].bytes[tag] = std::min(segmentFloors[1].bytes[tag],
+                                             segmentFloors[2].bytes[tag]);
+    }
+    segmentFloors.erase(segmentFloors.begin() + 2);
+  }
+}
+
+//--------------------------------------------------------------
+const MemorySample& MemoryStats::latest() const {
+  return at(0);
+}
+
+//--------------------------------------------------------------
+const MemorySample& MemoryStats::at(int age) const {
+  return ring[(head + MEMORY_RING_SIZE - age) % MEMORY_RING_SIZE];
+}
+
+//--------------------------------------------------------------
+size_t MemoryStats::segmentsFloor(int tag, size_t first, size_t last) const {
+  size_t floor = segmentFloors[first].bytes[tag];
+  for (size_t i = first + 1; i < last; i++) {
+    floor = std::min(floor, segmentFloors[i].bytes[tag]);
+  }
+  return floor;
+}
+
+//--------------------------------------------------------------
+bool MemoryStats::isConclusive() const {
+  // the first segment loads everything for the first time, skip it
+  return segmentFloors.size() >= MEMORY_MIN_SEGMENTS + 1;
+}
+
+//--------------------------------------------------------------
+vector<string> MemoryStats::getGrowing() const {
+  vector<string> growing;
+  if (!isConclusive()) {
+    return growing;
+  }
+
+  // split the segments after warm-up into thirds, a leak lifts the floor of
+  // each third above the one before, across the whole run
+  size_t first = 1;
+  size_t segments = segmentFloors.size() - first;
+  size_t third = segments / 3;
+  for (int tag = 0; tag < MEMORY_NUM_TAGS; tag++) {
+    size_t oldest = segmentsFloor(tag, first, first + third);
+    size_t middle = segmentsFloor(tag, first + third, first + third * 2);
+    size_t newest = segmentsFloor(tag, first + third * 2, segmentFloors.size());
+    if (oldest < middle && middle < newest &&
+        newest - oldest >= MEMORY_LEAK_MIN_BYTES) {
+      growing.push_back(tagName(tag));
+    }
+  }
+  return growing;
+}
+
+//--------------------------------------------------------------
+string MemoryStats::report() const {
+  if (count == 0) {
+    return "no samples";
+  }
+  const MemorySample& sample = latest();
+  string out;
+  for (int tag = 0; tag < MEMORY_NUM_TAGS; tag++) {
+    out += string(tagName(tag)) + ":" + ofToString(sample.bytes[tag] / 1024) + "KB ";
+  }
+  out += "segments:" + ofToString(segmentFloors.size()) + " ";
+  vector<string> growing = getGrowing();
+  if (!growing.empty()) {
+    out += "GROWING: " + ofJoinString(growing, ",");
+  }
+  return out;
+}
+
+//--------------------------------------------------------------
+const char* MemoryStats::tagName(int tag) {
+  switch (tag) {
+  case MEMORY_LUA:
+    return "lua";
+  case MEMORY_TEXTURES:
+    return "textures";
+  case MEMORY_AUDIO:
+    return "audio";
+  case MEMORY_QUEUES:
+    return "queues";
+  case MEMORY_PROCESS:
+    return "rss";
+  }
+  return "unknown";
+}
+
+//--------------------------------------------------------------
+size_t MemoryStats::processResidentBytes() {
+  // second field of statm is resident pages
+  size_t pages = 0;
+  size_t resident = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm) {
+    if (fscanf(statm, "%zu %zu", &pages, &resident) != 2) {
+      resident = 0;
+    }
+    fclose(statm);
+  }
+  return resident * sysconf(_SC_PAGESIZE);
+}
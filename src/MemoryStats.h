@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2020 Owen Osborn, Critter & Gutiari, Inc.
+ *
+ * BSD Simplified License.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ *
+ */
+#pragma once
+
+#include "ofMain.h"
+
+#define MEMORY_RING_SIZE 600        // 10 minutes at one sample per second
+#define MEMORY_LEAK_MIN_BYTES 65536 // ignore growth smaller than this
+#define MEMORY_MIN_SEGMENTS 3       // segments needed, after warm-up, to judge
+#define MEMORY_MAX_SEGMENTS 1024    // about a week of 10 minute segments
+
+enum MemoryTag {
+    MEMORY_LUA,
+    MEMORY_TEXTURES,
+    MEMORY_AUDIO,
+    MEMORY_QUEUES,
+    MEMORY_PROCESS,
+    MEMORY_NUM_TAGS
+};
+
+struct MemorySample {
+    float   time;
+    size_t  bytes[MEMORY_NUM_TAGS];
+};
+
+// Ring of per-subsystem memory samples with a long-run leak check. The run is
+// cut into segments, either one per full mode cycle (soak) or one per ring of
+// samples, and a leak is a floor that keeps rising from segment to segment.
+// The host fills in the numbers, this class only keeps and judges them.
+class MemoryStats {
+
+    public:
+        MemoryStats();
+
+        bool    isDue(float now) const;
+        void    record(const MemorySample& sample);
+
+        const MemorySample& latest() const;
+        size_t  getNumSamples() const { return count; }
+
+        // soak mode ends segments itself once per mode cycle, otherwise a
+        // segment ends after every MEMORY_RING_SIZE samples
+        void    setCycleDriven(bool cycleDriven);
+        void    endSegment();
+        size_t  getNumSegments() const { return segmentFloors.size(); }
+
+        // tags whose floor keeps rising across the whole run
+        bool    isConclusive() const;
+        vector<string> getGrowing() const;
+        string  report() const;
+
+        static const char* tagName(int tag);
+        static size_t processResidentBytes();
+
+    private:
+        size_t  segmentsFloor(int tag, size_t first, size_t last) const;
+        const MemorySample& at(int age) const;
+
+        vector<MemorySample>    ring;
+        size_t                  head;
+        size_t                  count;
+        float                   lastTime;
+
+        // per tag minimum of each finished segment, the first one is warm-up
+        vector<MemorySample>    segmentFloors;
+        MemorySample            currentFloor;
+        size_t                  segmentSamples;
+        bool                    cycleDriven;
+};
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2020 Owen Osborn, Critter & Gutiari, Inc.
+ *
+ * BSD Simplified License.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ *
+ */
+#include "ModeIndex.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+//--------------------------------------------------------------
+ModeIndex::ModeIndex() {
+  dirty = false;
+}
+
+//--------------------------------------------------------------
+void ModeIndex::load(const string& file) {
+  cacheFile = file;
+  modes.clear();
+  if (!ofFile::doesFileExist(cacheFile, false)) {
+    return;
+  }
+
+  // one mode per line: path, load time in ms, title
+  ofBuffer buffer = ofBufferFromFile(cacheFile);
+  for (auto& line : buffer.getLines()) {
+    vector<string> fields = ofSplitString(line, "\t");
+    if (fields.size() < 3 || fields[0].empty()) {
+      continue;
+    }
+    modes.push_back({fields[0], fields[2], ofToFloat(fields[1])});
+  }
+}
+
+//--------------------------------------------------------------
+void ModeIndex::save() {
+  if (cacheFile.empty()) {
+    return;
+  }
+
+  // changes made while we're writing mark it dirty again
+  string out;
+  {
+    std::lock_guard<std::mutex> lock(modesMutex);
+    for (const Mode& mode : modes) {
+      out += mode.path + "\t" + ofToString(mode.loadMillis, 1) + "\t" + mode.title + "\n";
+    }
+    dirty = false;
+  }
+
+  // write, sync, then rename so a power cut never leaves half a cache behind
+  string tmpFile = cacheFile + ".tmp";
+  FILE* file = fopen(tmpFile.c_str(), "w");
+  bool written = file && fwrite(out.data(), 1, out.size(), file) == out.size() &&
+                 fflush(file) == 0 && fsync(fileno(file)) == 0;
+  if (file) {
+    fclose(file);
+  }
+  if (!written || std::rename(tmpFile.c_str(), cacheFile.c_str()) != 0) {
+    ofLogWarning("MODE INDEX") << "could not write " << cacheFile;
+    std::lock_guard<std::mutex> lock(modesMutex);
+    dirty = true;
+    return;
+  }
+
+  // and sync the directory so the rename itself survives
+  int dir = open(ofFilePath::getEnclosingDirectory(cacheFile, false).c_str(), O_RDONLY);
+  if (dir >= 0) {
+    fsync(dir);
+    close(dir);
+  }
+}
+
+//--------------------------------------------------------------
+void ModeIndex::saveIfDirty() {
+  if (isDirty()) {
+    save();
+  }
+}
+
+//--------------------------------------------------------------
+bool ModeIndex::isDirty() const {
+  std::lock_guard<std::mutex> lock(modesMutex);
+  return dirty;
+}
+
+//--------------------------------------------------------------
+vector<string> ModeIndex::getPaths() const {
+  std::lock_guard<std::mutex> lock(modesMutex);
+  vector<string> paths;
+  for (const Mode& mode : modes) {
+    paths.push_back(mode.path);
+  }
+  return paths;
+}
+
+//--------------------------------------------------------------
+bool ModeIndex::revalidate(const vector<string>& paths) {
+  if (paths == getPaths()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(modesMutex);
+
+  // keep what we know about modes that are still there
+  vector<Mode> fresh;
+  for (const string& path : paths) {
+    Mode mode = {path, "", 0.0f};
+    for (const Mode& known : modes) {
+      if (known.path == path) {
+        mode = known;
+        break;
+      }
+    }
+    fresh.push_back(mode);
+  }
+  modes = fresh;
+  dirty = true;
+  return true;
+}
+
+//--------------------------------------------------------------
+void ModeIndex::setLoaded(const string& path, const string& title, float loadMillis) {
+  std::lock_guard<std::mutex> lock(modesMutex);
+  for (Mode& mode : modes) {
+    if (mode.path == path) {
+      mode.title = title;
+      mode.loadMillis = loadMillis;
+      dirty = true;
+      return;
+    }
+  }
+}
+
+//--------------------------------------------------------------
+vector<string> ModeIndex::scan(const string& modesDir) {
+  vector<string> paths;
+  ofDirectory dir(modesDir);
+  dir.listDir();
+  for (size_t i = 0; i < dir.size(); i++) {
+    paths.push_back(dir.getPath(i) + "/main.lua");
+  }
+  return paths;
+}
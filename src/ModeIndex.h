@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2020 Owen Osborn, Critter & Gutiari, Inc.
+ *
+ * BSD Simplified License.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ *
+ */
+#pragma once
+
+#include "ofMain.h"
+
+// On-disk cache of the mode list so the first script can start before the
+// modes folder has been scanned. The cache is revalidated against a fresh
+// scan once that finishes. save() may run on another thread while the render
+// thread keeps updating the list.
+class ModeIndex {
+
+    public:
+        struct Mode {
+            string  path;
+            string  title;
+            float   loadMillis;
+        };
+
+        ModeIndex();
+
+        void    load(const string& cacheFile);
+        void    save();
+        void    saveIfDirty();
+        bool    isDirty() const;
+
+        // paths to every mode's main.lua, as last known
+        vector<string> getPaths() const;
+
+        // replace the list with a fresh scan, returns true if it changed
+        bool    revalidate(const vector<string>& paths);
+
+        // remember title and load time, written out by the next save
+        void    setLoaded(const string& path, const string& title, float loadMillis);
+
+        // slow, safe to run on another thread
+        static vector<string> scan(const string& modesDir);
+
+    private:
+        string          cacheFile;
+        mutable std::mutex modesMutex;  // modes and dirty, save() only holds it to copy
+        vector<Mode>    modes;
+        bool            dirty;
+};
@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2020 Owen Osborn, Critter & Gutiari, Inc.
+ *
+ * BSD Simplified License.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ *
+ */
+#include "PhysicsService.h"
+#include "LuaHostApi.h"
+
+//--------------------------------------------------------------
+PhysicsService::PhysicsService() {
+  world = nullptr;
+  writeIndex = 0;
+  readyIndex = 1;
+  readIndex = 2;
+  fresh = false;
+  stepMicros = 0;
+  random.seed(std::random_device()());
+  audioGain = 0.0f;
+  midiGain = 0.0f;
+
+  // reserve up front so the worker never reallocates while playing
+  bodies.reserve(PHYSICS_MAX_BODIES);
+  radii.reserve(PHYSICS_MAX_BODIES);
+  for (int i = 0; i < 3; i++) {
+    buffers[i].reserve(PHYSICS_MAX_BODIES * PHYSICS_STRIDE);
+  }
+}
+
+//--------------------------------------------------------------
+PhysicsService::~PhysicsService() {
+  stop();
+}
+
+//--------------------------------------------------------------
+void PhysicsService::start() {
+  if (world) {
+    return;
+  }
+
+  world = new b2World(b2Vec2(0, 10));
+
+  // static walls around the screen so bodies stay visible
+  float w = ofGetWidth() / OFX_BOX2D_SCALE;
+  float h = ofGetHeight() / OFX_BOX2D_SCALE;
+  float t = 1.0f;
+  b2BodyDef wallDef;
+  b2Body* walls = world->CreateBody(&wallDef);
+  b2PolygonShape wall;
+  wall.SetAsBox(w / 2, t, b2Vec2(w / 2, h + t), 0);
+  walls->CreateFixture(&wall, 0);
+  wall.SetAsBox(w / 2, t, b2Vec2(w / 2, -t), 0);
+  walls->CreateFixture(&wall, 0);
+  wall.SetAsBox(t, h / 2, b2Vec2(-t, h / 2), 0);
+  walls->CreateFixture(&wall, 0);
+  wall.SetAsBox(t, h / 2, b2Vec2(w + t, h / 2), 0);
+  walls->CreateFixture(&wall, 0);
+
+  startThread();
+}
+
+//--------------------------------------------------------------
+void PhysicsService::stop() {
+  if (!world) {
+    return;
+  }
+  waitForThread(true);
+  delete world;
+  world = nullptr;
+  bodies.clear();
+  radii.clear();
+  stepMicros = 0;
+
+  // nothing left to read or run until the next start()
+  {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    pending.clear();
+  }
+  std::lock_guard<std::mutex> lock(bufferMutex);
+  for (int i = 0; i < 3; i++) {
+    buffers[i].clear();
+  }
+  fresh = false;
+}
+
+//--------------------------------------------------------------
+void PhysicsService::sync() {
+  std::lock_guard<std::mutex> lock(bufferMutex);
+  if (fresh) {
+    std::swap(readIndex, readyIndex);
+    fresh = false;
+  }
+}
+
+//--------------------------------------------------------------
+void PhysicsService::spawn(int count, float x, float y, float radius, float spread) {
+  queue({COMMAND_SPAWN, x, y, radius, spread, 0, count});
+}
+
+//--------------------------------------------------------------
+void PhysicsService::applyForce(float fx, float fy, int first, int count) {
+  queue({COMMAND_FORCE, fx, fy, 0, 0, first, count});
+}
+
+//--------------------------------------------------------------
+void PhysicsService::radialImpulse(float x, float y, float strength) {
+  queue({COMMAND_IMPULSE, x, y, strength, 0, 0, 0});
+}
+
+//--------------------------------------------------------------
+void PhysicsService::setGravity(float x, float y) {
+  queue({COMMAND_GRAVITY, x, y, 0, 0, 0, 0});
+}
+
+//--------------------------------------------------------------
+void PhysicsService::clear() {
+  queue({COMMAND_CLEAR, 0, 0, 0, 0, 0, 0});
+}
+
+//--------------------------------------------------------------
+void PhysicsService::setDrive(float audio, float midi) {
+  audioGain = audio;
+  midiGain = midi;
+}
+
+//--------------------------------------------------------------
+void PhysicsService::driveAudio(float level) {
+  // louder input lifts every body against gravity
+  if (audioGain > 0 && level > 0) {
+    applyForce(0, -level * audioGain, 1, 0);
+  }
+}
+
+//--------------------------------------------------------------
+void PhysicsService::driveNote(int pitch, int velocity) {
+  // note-ons kick from the bottom edge, pitch picks the spot left to right
+  if (midiGain > 0 && velocity > 0) {
+    radialImpulse(ofMap(pitch, 0, 127, 0, ofGetWidth()), ofGetHeight(),
+                  velocity / 127.0f * midiGain);
+  }
+}
+
+//--------------------------------------------------------------
+void PhysicsService::queue(const Command& command) {
+  // modes that never touch physics never pay for the worker
+  if (!world) {
+    if (command.type == COMMAND_CLEAR) {
+      return;
+    }
+    start();
+  }
+  std::lock_guard<std::mutex> lock(commandMutex);
+  pending.push_back(command);
+}
+
+//--------------------------------------------------------------
+void PhysicsService::threadedFunction() {
+  auto period = std::chrono::microseconds(1000000 / PHYSICS_RATE);
+  auto next = std::chrono::steady_clock::now();
+
+  while (isThreadRunning()) {
+    {
+      std::lock_guard<std::mutex> lock(commandMutex);
+      executing.swap(pending);
+    }
+    for (const Command& command : executing) {
+      execute(command);
+    }
+    executing.clear();
+
+    uint64_t start = ofGetElapsedTimeMicros();
+    world->Step(1.0f / PHYSICS_RATE, 8, 3);
+    writeTransforms();
+    stepMicros = ofGetElapsedTimeMicros() - start;
+
+    // fixed rate, but don't try to catch up after a long stall
+    next += period;
+    auto now = std::chrono::steady_clock::now();
+    if (now > next + period) {
+      next = now;
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
+
+//--------------------------------------------------------------
+void PhysicsService::execute(const Command& command) {
+  switch (command.type) {
+
+  case COMMAND_SPAWN: {
+    int count = std::min(command.count, PHYSICS_MAX_BODIES - (int)bodies.size());
+    b2CircleShape shape;
+    shape.m_radius = command.z / OFX_BOX2D_SCALE;
+    b2FixtureDef fixture;
+    fixture.shape = &shape;
+    fixture.density = 1.0f;
+    fixture.friction = 0.3f;
+    fixture.restitution = 0.5f;
+    std::uniform_real_distribution<float> jitter(-command.w, command.w);
+    for (int i = 0; i < count; i++) {
+      b2BodyDef def;
+      def.type = b2_dynamicBody;
+      def.position.Set((command.x + jitter(random)) / OFX_BOX2D_SCALE,
+                       (command.y + jitter(random)) / OFX_BOX2D_SCALE);
+      b2Body* body = world->CreateBody(&def);
+      body->CreateFixture(&fixture);
+      bodies.push_back(body);
+      radii.push_back(command.z);
+    }
+    break;
+  }
+
+  case COMMAND_FORCE: {
+    // first is 1-based like the lua side, count <= 0 means all bodies
+    int first = std::max(command.first - 1, 0);
+    int last = command.count > 0 ? first + command.count : bodies.size();
+    last = std::min(last, (int)bodies.size());
+    b2Vec2 force(command.x, command.y);
+    for (int i = first; i < last; i++) {
+      bodies[i]->ApplyForceToCenter(force, true);
+    }
+    break;
+  }
+
+  case COMMAND_IMPULSE: {
+    b2Vec2 center(command.x / OFX_BOX2D_SCALE, command.y / OFX_BOX2D_SCALE);
+    for (b2Body* body : bodies) {
+      b2Vec2 dir = body->GetWorldCenter() - center;
+      float dist = dir.Normalize();
+      body->ApplyLinearImpulse(command.z / (1.0f + dist) * dir, body->GetWorldCenter(), true);
+    }
+    break;
+  }
+
+  case COMMAND_GRAVITY:
+    world->SetGravity(b2Vec2(command.x, command.y));
+    break;
+
+  case COMMAND_CLEAR:
+    for (b2Body* body : bodies) {
+      world->DestroyBody(body);
+    }
+    bodies.clear();
+    radii.clear();
+    break;
+  }
+}
+
+//--------------------------------------------------------------
+void PhysicsService::writeTransforms() {
+  vector<float>& out = buffers[writeIndex];
+  out.resize(bodies.size() * PHYSICS_STRIDE);
+
+  float* p = out.data();
+  for (size_t i = 0; i < bodies.size(); i++) {
+    const b2Vec2& pos = bodies[i]->GetPosition();
+    *p++ = pos.x * OFX_BOX2D_SCALE;
+    *p++ = pos.y * OFX_BOX2D_SCALE;
+    *p++ = bodies[i]->GetAngle();
+    *p++ = radii[i];
+  }
+
+  std::lock_guard<std::mutex> lock(bufferMutex);
+  std::swap(writeIndex, readyIndex);
+  fresh = true;
+}
+
+//--------------------------------------------------------------
+// Lua bindings
+//--------------------------------------------------------------
+
+// physics_spawn(count, x, y, radius [, spread])
+static int l_physics_spawn(lua_State* L) {
+  luaHostSelf<PhysicsService>(L)->spawn(luaL_checkinteger(L, 1),
+                                        luaL_checknumber(L, 2),
+                                        luaL_checknumber(L, 3),
+                                        luaL_checknumber(L, 4),
+                                        luaL_optnumber(L, 5, 0));
+  return 0;
+}
+
+// physics_force(fx, fy [, first, count])
+static int l_physics_force(lua_State* L) {
+  luaHostSelf<PhysicsService>(L)->applyForce(luaL_checknumber(L, 1),
+                                             luaL_checknumber(L, 2),
+                                             luaL_optinteger(L, 3, 1),
+                                             luaL_optinteger(L, 4, 0));
+  return 0;
+}
+
+// physics_impulse(x, y, strength), radial from x, y
+static int l_physics_impulse(lua_State* L) {
+  luaHostSelf<PhysicsService>(L)->radialImpulse(luaL_checknumber(L, 1),
+                                                luaL_checknumber(L, 2),
+                                                luaL_checknumber(L, 3));
+  return 0;
+}
+
+// physics_gravity(x, y)
+static int l_physics_gravity(lua_State* L) {
+  luaHostSelf<PhysicsService>(L)->setGravity(luaL_checknumber(L, 1),
+                                             luaL_checknumber(L, 2));
+  return 0;
+}
+
+// physics_clear()
+static int l_physics_clear(lua_State* L) {
+  luaHostSelf<PhysicsService>(L)->clear();
+  return 0;
+}
+
+// physics_drive(audioGain [, midiGain]), let the host push bodies from the
+// audio level and incoming note-ons, 0 turns either off
+static int l_physics_drive(lua_State* L) {
+  luaHostSelf<PhysicsService>(L)->setDrive(luaL_checknumber(L, 1),
+                                           luaL_optnumber(L, 2, 0));
+  return 0;
+}
+
+// physics_count() -> number of bodies
+static int l_physics_count(lua_State* L) {
+  lua_pushinteger(L, luaHostSelf<PhysicsService>(L)->getNumBodies());
+  return 1;
+}
+
+// physics_read(t) -> count, fills t with {x, y, angle, radius} per body in one
+// call, reuse the same table every frame so it only grows once. This copies
+// every float, prefer physics_buffer() where ffi is available
+static int l_physics_read(lua_State* L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  const vector<float>& transforms = luaHostSelf<PhysicsService>(L)->getTransforms();
+  lua_Integer count = transforms.size();
+  for (lua_Integer i = 0; i < count; i++) {
+    lua_pushnumber(L, transforms[i]);
+    lua_rawseti(L, 1, i + 1);
+  }
+
+  // drop whatever is left over from a frame with more bodies
+  for (lua_Integer i = count + 1;; i++) {
+    lua_rawgeti(L, 1, i);
+    bool stale = !lua_isnil(L, -1);
+    lua_pop(L, 1);
+    if (!stale) {
+      break;
+    }
+    lua_pushnil(L);
+    lua_rawseti(L, 1, i);
+  }
+
+  lua_pushinteger(L, count);
+  return 1;
+}
+
+// physics_buffer() -> pointer, count, the raw float buffer for an ffi cast
+// (ffi.cast("const float*", p)), valid until the next frame. This is the
+// primary read path, nothing is copied: body i (0-based) starts at p[i * 4]
+static int l_physics_buffer(lua_State* L) {
+  const vector<float>& transforms = luaHostSelf<PhysicsService>(L)->getTransforms();
+  lua_pushlightuserdata(L, (void*)transforms.data());
+  lua_pushinteger(L, transforms.size());
+  return 2;
+}
+
+// physics_body(i) -> x, y, angle, radius, one body at a time
+static int l_physics_body(lua_State* L) {
+  const vector<float>& transforms = luaHostSelf<PhysicsService>(L)->getTransforms();
+  lua_Integer i = luaL_checkinteger(L, 1);
+  if (i < 1 || i * PHYSICS_STRIDE > (lua_Integer)transforms.size()) {
+    return 0;
+  }
+  const float* body = &transforms[(i - 1) * PHYSICS_STRIDE];
+  for (int j = 0; j < PHYSICS_STRIDE; j++) {
+    lua_pushnumber(L, body[j]);
+  }
+  return PHYSICS_STRIDE;
+}
+
+//--------------------------------------------------------------
+void PhysicsService::bindLua(lua_State* L) {
+  luaRegisterHostFunction(L, "physics_spawn", l_physics_spawn, this);
+  luaRegisterHostFunction(L, "physics_force", l_physics_force, this);
+  luaRegisterHostFunction(L, "physics_impulse", l_physics_impulse, this);
+  luaRegisterHostFunction(L, "physics_gravity", l_physics_gravity, this);
+  luaRegisterHostFunction(L, "physics_clear", l_physics_clear, this);
+  luaRegisterHostFunction(L, "physics_drive", l_physics_drive, this);
+  luaRegisterHostFunction(L, "physics_count", l_physics_count, this);
+  luaRegisterHostFunction(L, "physics_read", l_physics_read, this);
+  luaRegisterHostFunction(L, "physics_buffer", l_physics_buffer, this);
+  luaRegisterHostFunction(L, "physics_body", l_physics_body, this);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2020 Owen Osborn, Critter & Gutiari, Inc.
+ *
+ * BSD Simplified License.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ *
+ */
+#pragma once
+
+#include "ofMain.h"
+#include "ofxBox2d.h"
+#include <random>
+
+struct lua_State;
+
+#define PHYSICS_RATE 60
+#define PHYSICS_MAX_BODIES 8000
+#define PHYSICS_STRIDE 4    // x, y, angle, radius per body, in screen units
+
+// Steps a Box2D world at a fixed rate on its own thread. Scripts queue batched
+// commands (spawn, force, impulse) and read back every body's transform from a
+// flat float array that is swapped in once per frame by sync(). Scripts should
+// read it through physics_buffer() and an ffi cast, physics_read() copies it
+// into a table for code that can't use ffi.
+class PhysicsService : public ofThread {
+
+    public:
+        PhysicsService();
+        ~PhysicsService();
+
+        // the worker starts on the first queued command, stop() drops the
+        // world and the thread until a script asks for physics again
+        void    start();
+        void    stop();
+
+        // render thread: pick up the latest transforms, call once per frame
+        void    sync();
+
+        // batched commands, safe to call from the render thread
+        void    spawn(int count, float x, float y, float radius, float spread);
+        void    applyForce(float fx, float fy, int first, int count);
+        void    radialImpulse(float x, float y, float strength);
+        void    setGravity(float x, float y);
+        void    clear();
+
+        // host driven input, off until a script sets a gain with physics_drive()
+        void    setDrive(float audioGain, float midiGain);
+        void    driveAudio(float level);
+        void    driveNote(int pitch, int velocity);
+
+        // transforms visible to the render thread until the next sync()
+        const vector<float>& getTransforms() const { return buffers[readIndex]; }
+        size_t  getNumBodies() const { return buffers[readIndex].size() / PHYSICS_STRIDE; }
+        float   getStepMillis() const { return stepMicros.load() / 1000.0f; }
+
+        // register physics_* functions in the given lua state
+        void    bindLua(lua_State* L);
+
+    private:
+        enum CommandType {
+            COMMAND_SPAWN,
+            COMMAND_FORCE,
+            COMMAND_IMPULSE,
+            COMMAND_GRAVITY,
+            COMMAND_CLEAR
+        };
+
+        struct Command {
+            CommandType type;
+            float       x, y, z, w;
+            int         first, count;
+        };
+
+        void    threadedFunction();
+        void    queue(const Command& command);
+        void    execute(const Command& command);
+        void    writeTransforms();
+
+        // owned by the worker thread
+        b2World*            world;
+        vector<b2Body*>     bodies;
+        vector<float>       radii;
+        vector<Command>     executing;
+        std::mt19937        random;     // ofRandom is shared with the render thread
+
+        // render thread -> worker
+        std::mutex          commandMutex;
+        vector<Command>     pending;
+
+        // worker -> render thread, triple buffered
+        std::mutex          bufferMutex;
+        vector<float>       buffers[3];
+        int                 writeIndex;
+        int                 readyIndex;
+        int                 readIndex;
+        bool                fresh;
+
+        std::atomic<int>    stepMicros;
+
+        // render thread only
+        float               audioGain;
+        float               midiGain;
+};
@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2020 Owen Osborn, Critter & Gutiari, Inc.
+ *
+ * BSD Simplified License.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ *
+ */
+#include "RenderTargetPool.h"
+#include "LuaHostApi.h"
+
+//--------------------------------------------------------------
+bool RenderTargetPool::Key::operator==(const Key& other) const {
+  return width == other.width && height == other.height &&
+         internalFormat == other.internalFormat &&
+         numSamples == other.numSamples;
+}
+
+//--------------------------------------------------------------
+RenderTargetPool::RenderTargetPool() {
+  allocationCount = 0;
+  gpuBytes = 0;
+  releaseCounter = 0;
+  capLogged = false;
+}
+
+//--------------------------------------------------------------
+ofFbo* RenderTargetPool::acquire(int width, int height, int internalFormat, int numSamples) {
+  int handle = acquireEntry(width, height, internalFormat, numSamples, false);
+  return entries[handle - 1].fbo.get();
+}
+
+//--------------------------------------------------------------
+void RenderTargetPool::release(ofFbo* fbo) {
+  for (Entry& entry : entries) {
+    if (entry.fbo && entry.fbo.get() == fbo) {
+      markReleased(entry);
+      return;
+    }
+  }
+}
+
+//--------------------------------------------------------------
+int RenderTargetPool::acquireHandle(int width, int height, int internalFormat, int numSamples) {
+  return acquireEntry(width, height, internalFormat, numSamples, true);
+}
+
+//--------------------------------------------------------------
+ofFbo* RenderTargetPool::get(int handle) {
+  if (handle < 1 || handle > (int)entries.size()) {
+    return nullptr;
+  }
+  Entry& entry = entries[handle - 1];
+  if (!entry.inUse || !entry.ownedByScript) {
+    return nullptr;
+  }
+  return entry.fbo.get();
+}
+
+//--------------------------------------------------------------
+void RenderTargetPool::releaseHandle(int handle) {
+  if (get(handle) == nullptr) {
+    return;
+  }
+  end(handle);
+  markReleased(entries[handle - 1]);
+}
+
+//--------------------------------------------------------------
+void RenderTargetPool::releaseScriptHandles() {
+  // called on script reload, the targets stay allocated for the next mode
+  endAll();
+  for (Entry& entry : entries) {
+    if (entry.ownedByScript) {
+      markReleased(entry);
+    }
+  }
+
+  // next script gets its own warning
+  capLogged = false;
+}
+
+//--------------------------------------------------------------
+void RenderTargetPool::markReleased(Entry& entry) {
+  entry.inUse = false;
+  entry.ownedByScript = false;
+  entry.releasedAt = ++releaseCounter;
+}
+
+//--------------------------------------------------------------
+bool RenderTargetPool::trimTo(size_t bytes) {
+  // free idle targets, least recently released first, until bytes fit
+  while (gpuBytes + bytes > RENDER_TARGET_BUDGET) {
+    Entry* oldest = nullptr;
+    for (Entry& entry : entries) {
+      if (entry.fbo && !entry.inUse &&
+          (!oldest || entry.releasedAt < oldest->releasedAt)) {
+        oldest = &entry;
+      }
+    }
+    if (!oldest) {
+      return false;
+    }
+    oldest->fbo.reset();
+    gpuBytes -= bytesFor(oldest->key);
+  }
+  return true;
+}
+
+//--------------------------------------------------------------
+void RenderTargetPool::begin(int handle) {
+  ofFbo* fbo = get(handle);
+  if (fbo) {
+    fbo->begin();
+    begun.push_back(handle);
+  }
+}
+
+//--------------------------------------------------------------
+void RenderTargetPool::end(int handle) {
+  // end everything begun after this one too, fbo begin/end must nest
+  auto it = std::find(begun.begin(), begun.end(), handle);
+  if (it == begun.end()) {
+    return;
+  }
+  while (begun.size() > (size_t)(it - begun.begin())) {
+    entries[begun.back() - 1].fbo->end();
+    begun.pop_back();
+  }
+}
+
+//--------------------------------------------------------------
+void RenderTargetPool::endAll() {
+  while (!begun.empty()) {
+    entries[begun.back() - 1].fbo->end();
+    begun.pop_back();
+  }
+}
+
+//--------------------------------------------------------------
+size_t RenderTargetPool::getNumTargets() const {
+  size_t count = 0;
+  for (const Entry& entry : entries) {
+    if (entry.fbo) {
+      count++;
+    }
+  }
+  return count;
+}
+
+//--------------------------------------------------------------
+size_t RenderTargetPool::getNumInUse() const {
+  size_t count = 0;
+  for (const Entry& entry : entries) {
+    if (entry.inUse) {
+      count++;
+    }
+  }
+  return count;
+}
+
+//--------------------------------------------------------------
+int RenderTargetPool::acquireEntry(int width, int height, int internalFormat, int numSamples, bool script) {
+  Key key = {width, height, internalFormat, numSamples};
+
+  if (script) {
+    size_t held = 0;
+    for (const Entry& entry : entries) {
+      if (entry.ownedByScript) {
+        held++;
+      }
+    }
+    if (held >= RENDER_TARGET_MAX_SCRIPT_HANDLES) {
+      if (!capLogged) {
+        ofLogWarning("FBO POOL") << "script holds " << held
+                                 << " targets, release some with fbo_release()";
+        capLogged = true;
+      }
+      return 0;
+    }
+  }
+
+  // reuse a free target with the same key if we have one
+  for (size_t i = 0; i < entries.size(); i++) {
+    Entry& entry = entries[i];
+    if (entry.fbo && !entry.inUse && entry.key == key) {
+      entry.inUse = true;
+      entry.ownedByScript = script;
+
+      // previous owner may have left content behind
+      entry.fbo->begin();
+      ofClear(0, 0, 0, 0);
+      entry.fbo->end();
+      return i + 1;
+    }
+  }
+
+  // scripts are refused past the budget, the host always gets its target
+  if (!trimTo(bytesFor(key)) && script) {
+    if (!capLogged) {
+      ofLogWarning("FBO POOL") << "over the " << RENDER_TARGET_BUDGET / (1024 * 1024)
+                               << "MB budget, refusing " << width << "x" << height;
+      capLogged = true;
+    }
+    return 0;
+  }
+
+  // reuse a slot whose target was trimmed so handles stay small
+  size_t slot = entries.size();
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (!entries[i].fbo) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot == entries.size()) {
+    entries.push_back(Entry());
+  }
+
+  Entry& entry = entries[slot];
+  entry.key = key;
+  entry.fbo.reset(new ofFbo());
+  entry.fbo->allocate(width, height, internalFormat, numSamples);
+  entry.inUse = true;
+  entry.ownedByScript = script;
+  entry.releasedAt = 0;
+
+  entry.fbo->begin();
+  ofClear(0, 0, 0, 0);
+  entry.fbo->end();
+
+  allocationCount++;
+  gpuBytes += bytesFor(key);
+  return slot + 1;
+}
+
+//--------------------------------------------------------------
+size_t RenderTargetPool::bytesFor(const Key& key) {
+  size_t bytesPerPixel = 4;
+  switch (key.internalFormat) {
+  case GL_RGB:
+    bytesPerPixel = 3;
+    break;
+#ifndef TARGET_OPENGLES
+  case GL_RGBA16F:
+    bytesPerPixel = 8;
+    break;
+  case GL_RGBA32F:
+    bytesPerPixel = 16;
+    break;
+#endif
+  case GL_LUMINANCE:
+    bytesPerPixel = 1;
+    break;
+  }
+
+  // resolve texture plus the multisampled renderbuffer if any
+  size_t pixels = (size_t)key.width * key.height;
+  return pixels * bytesPerPixel * (1 + key.numSamples);
+}
+
+//--------------------------------------------------------------
+// Lua bindings
+//--------------------------------------------------------------
+
+// fbo_acquire(width, height [, internalFormat, numSamples]) -> handle
+static int l_fbo_acquire(lua_State* L) {
+  RenderTargetPool* pool = luaHostSelf<RenderTargetPool>(L);
+  int width = luaL_checkinteger(L, 1);
+  int height = luaL_checkinteger(L, 2);
+  luaL_argcheck(L, width > 0, 1, "width must be positive");
+  luaL_argcheck(L, height > 0, 2, "height must be positive");
+  int internalFormat = luaL_optinteger(L, 3, GL_RGBA);
+  int numSamples = luaL_optinteger(L, 4, 0);
+  lua_pushinteger(L, pool->acquireHandle(width, height, internalFormat, numSamples));
+  return 1;
+}
+
+// fbo_release(handle)
+static int l_fbo_release(lua_State* L) {
+  luaHostSelf<RenderTargetPool>(L)->releaseHandle(luaL_checkinteger(L, 1));
+  return 0;
+}
+
+// fbo_begin(handle)
+static int l_fbo_begin(lua_State* L) {
+  luaHostSelf<RenderTargetPool>(L)->begin(luaL_checkinteger(L, 1));
+  return 0;
+}
+
+// fbo_end(handle)
+static int l_fbo_end(lua_State* L) {
+  luaHostSelf<RenderTargetPool>(L)->end(luaL_checkinteger(L, 1));
+  return 0;
+}
+
+// fbo_draw(handle, x, y [, width, height])
+static int l_fbo_draw(lua_State* L) {
+  ofFbo* fbo = luaHostSelf<RenderTargetPool>(L)->get(luaL_checkinteger(L, 1));
+  if (fbo) {
+    float x = luaL_optnumber(L, 2, 0);
+    float y = luaL_optnumber(L, 3, 0);
+    float w = luaL_optnumber(L, 4, fbo->getWidth());
+    float h = luaL_optnumber(L, 5, fbo->getHeight());
+    fbo->draw(x, y, w, h);
+  }
+  return 0;
+}
+
+//--------------------------------------------------------------
+void RenderTargetPool::bindLua(lua_State* L) {
+  luaRegisterHostFunction(L, "fbo_acquire", l_fbo_acquire, this);
+  luaRegisterHostFunction(L, "fbo_release", l_fbo_release, this);
+  luaRegisterHostFunction(L, "fbo_begin", l_fbo_begin, this);
+  luaRegisterHostFunction(L, "fbo_end", l_fbo_end, this);
+  luaRegisterHostFunction(L, "fbo_draw", l_fbo_draw, this);
+}
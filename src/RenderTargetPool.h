@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2020 Owen Osborn, Critter & Gutiari, Inc.
+ *
+ * BSD Simplified License.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ *
+ */
+#pragma once
+
+#include "ofMain.h"
+
+struct lua_State;
+
+#define RENDER_TARGET_BUDGET (96 * 1024 * 1024)    // GPU bytes before idle targets are freed
+#define RENDER_TARGET_MAX_SCRIPT_HANDLES 16
+
+// Host managed pool of render targets, keyed by size, format and sample count.
+// Releasing a target returns it to the pool so the next mode asking for the
+// same key gets it back without touching the GPU allocator. Idle targets are
+// only freed, least recently released first, when a new one would take the
+// pool past RENDER_TARGET_BUDGET.
+class RenderTargetPool {
+
+    public:
+        struct Key {
+            int width;
+            int height;
+            int internalFormat;
+            int numSamples;
+
+            bool operator==(const Key& other) const;
+        };
+
+        RenderTargetPool();
+
+        // host side access
+        ofFbo*  acquire(int width, int height, int internalFormat = GL_RGBA, int numSamples = 0);
+        void    release(ofFbo* fbo);
+
+        // script side access, handles are 1-based, 0 when over the handle cap
+        // or the byte budget
+        int     acquireHandle(int width, int height, int internalFormat = GL_RGBA, int numSamples = 0);
+        ofFbo*  get(int handle);
+        void    releaseHandle(int handle);
+        void    releaseScriptHandles();
+
+        // script begin/end, tracked so a script that errors between the two
+        // can't leave its target bound for the rest of the frame
+        void    begin(int handle);
+        void    end(int handle);
+        void    endAll();
+
+        // register fbo_* functions in the given lua state
+        void    bindLua(lua_State* L);
+
+        // stats
+        size_t  getNumTargets() const;
+        size_t  getNumInUse() const;
+        size_t  getAllocationCount() const { return allocationCount; }
+        size_t  getGpuBytes() const { return gpuBytes; }
+
+    private:
+        struct Entry {
+            Key                     key;
+            unique_ptr<ofFbo>       fbo;
+            bool                    inUse;
+            bool                    ownedByScript;
+            uint64_t                releasedAt;     // release order, for trimming
+        };
+
+        int     acquireEntry(int width, int height, int internalFormat, int numSamples, bool script);
+        void    markReleased(Entry& entry);
+        bool    trimTo(size_t bytes);
+        static size_t bytesFor(const Key& key);
+
+        vector<Entry>   entries;
+        vector<int>     begun;
+        size_t          allocationCount;
+        size_t          gpuBytes;
+        uint64_t        releaseCounter;
+        bool            capLogged;
+};
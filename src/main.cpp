@@ -13,5 +13,5 @@
 int main() {
     ofSetupOpenGL(1920, 1080, OF_FULLSCREEN);
     //ofSetupOpenGL(1280, 720, OF_FULLSCREEN);
-    ofRunApp(new ofApp());
+    return ofRunApp(new ofApp());
 }
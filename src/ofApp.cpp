@@ -12,12 +12,26 @@
 //--------------------------------------------------------------
 ofApp::ofApp() {
   midiClock = nullptr;
+  persistFbo = nullptr;
   persistEnabled = false;
   persistFirstRender = true;
   osdEnabled = false;
   audioLevel = 0.0f;
   clockMessageCount = 0;
   calculatedBPM = 120.0f;
+  soakInterval = 0.0f;
+  soakCycles = 0;
+  soakLastSwitch = 0.0f;
+  physicsBenchStage = -1;
+  physicsBenchStart = 0.0f;
+  physicsBenchFailed = false;
+  clipTestEnd = 0.0f;
+  startupMillis = 0;
+  lastPhaseMillis = 0;
+  firstFrameDrawn = false;
+  lastModeScan = 0.0f;
+  lastScriptSwitch = 0.0f;
+  lastModeIndexSave = -MODE_INDEX_SAVE_INTERVAL;
 }
 
 //--------------------------------------------------------------
@@ -30,10 +44,9 @@ ofApp::~ofApp() {
 
 //--------------------------------------------------------------
 void ofApp::setup() {
-
-  // listen on the given port
-  // cout << "listening for osc messages on port " << PORT << "\n";
-  receiver.setup(PORT);
+  startupMillis = ofGetElapsedTimeMillis();
+  lastPhaseMillis = startupMillis;
+  firstFrameDrawn = false;
 
   ofSetVerticalSync(true);
   ofSetFrameRate(60);
@@ -43,8 +56,10 @@ void ofApp::setup() {
 
   ofSetBackgroundColor(0, 0, 0);
 
-  // setup audio
-  soundStream.printDeviceList();
+  // put a black frame up straight away, the rest of setup takes a while
+  ofClear(0, 0, 0);
+  ofGetCurrentWindow()->swapBuffers();
+  logStartupPhase("black frame");
 
   int bufferSize = 256;
 
@@ -53,31 +68,36 @@ void ofApp::setup() {
 
   bufferCounter = 0;
 
-  ofSoundStreamSettings settings;
-
-  // device by name
-  auto devices = soundStream.getMatchingDevices("default");
-  if (!devices.empty()) {
-    settings.setInDevice(devices[0]);
-  }
-
-  settings.setInListener(this);
-  settings.sampleRate = 11025;
-  settings.numOutputChannels = 0;
-  settings.numInputChannels = 2;
-  settings.bufferSize = bufferSize;
-  soundStream.setup(settings);
-
-  // some path, may be absolute or relative to bin/data
-  string path = "/sdcard/Modes/oFLua";
-  ofDirectory dir(path);
-  dir.listDir();
+  // Initialize MIDI Clock, the MIDI listener feeds it as soon as the port opens
+  midiClock = new ofxMidiClock();
 
-  // go through and print out all the paths
-  for (int i = 0; i < dir.size(); i++) {
-    // ofLogNotice(dir.getPath(i) + "/main.lua");
-    scripts.push_back(dir.getPath(i) + "/main.lua");
+  // audio, MIDI and OSC don't touch GL or lua so they open on other
+  // threads while the first script compiles
+  startupTasks.emplace_back("audio", std::async(std::launch::async, [this]() { setupAudio(); }));
+  startupTasks.emplace_back("midi", std::async(std::launch::async, [this]() { setupMidi(); }));
+  startupTasks.emplace_back("osc", std::async(std::launch::async, [this]() {
+    // listen on the given port
+    // cout << "listening for osc messages on port " << PORT << "\n";
+    receiver.setup(PORT);
+  }));
+
+  // start from the cached mode list, update() swaps in the fresh scan
+  modeIndex.load(ofToDataPath("modeindex.txt", true));
+  modeScan = std::async(std::launch::async, []() { return ModeIndex::scan(MODES_DIR); });
+  scripts = modeIndex.getPaths();
+  if (scripts.empty() || !ofFile::doesFileExist(scripts[0], false)) {
+    // first boot or a stale cache, wait for the scan
+    vector<string> scanned = modeScan.get();
+    lastModeScan = ofGetElapsedTimef();
+    if (!scanned.empty()) {
+      modeIndex.revalidate(scanned);
+      scripts = modeIndex.getPaths();
+    } else {
+      // card not mounted yet, update() keeps scanning until modes show up
+      scripts.clear();
+    }
   }
+  logStartupPhase("mode index");
 
   // scripts to run
   currentScript = 0;
@@ -88,35 +108,160 @@ void ofApp::setup() {
   // listen to error events
   lua.addListener(this);
 
-  // setup MIDI BEFORE loading scripts
-  setupMidi();
-  
-  // Initialize MIDI Clock
-  midiClock = new ofxMidiClock();
+  // expose host services to the new state
+  bindHostApi();
 
   // Initialize persist graphics functionality
   persistEnabled = false;
   persistFirstRender = true;
-  persistFbo.allocate(ofGetWidth(), ofGetHeight());
+  persistFbo = renderTargets.acquire(ofGetWidth(), ofGetHeight());
 
   // MIDI globals are now initialized in the eyesy.lua module
 
-  // run a script
-  // true = change working directory to the script's parent dir
-  // so lua will find scripts with relative paths via require
-  // note: changing dir does *not* affect the OF data path
-  lua.doScript(scripts[currentScript], true);
+  // clip test paths are relative to where we were started, resolve them
+  // before the first script changes the working directory
+  vector<string> clipTestFiles;
+  const char* clipTest = getenv("EYESY_CLIP_TEST");
+  if (clipTest) {
+    for (const string& file : ofSplitString(clipTest, ",", true, true)) {
+      clipTestFiles.push_back(ofFilePath::getAbsolutePath(file, false));
+    }
+  }
 
-  // call the script's setup() function
-  lua.scriptSetup();
+  if (scripts.empty()) {
+    ofLogWarning("STARTUP") << "no modes in " << MODES_DIR;
+  } else {
+    runScript();
+    logStartupPhase("first script");
+  }
+
+  // MIDI and OSC are polled from update(), make sure they're up, a subsystem
+  // that failed to open is logged and the rest of the app runs without it
+  for (auto& task : startupTasks) {
+    try {
+      task.second.get();
+    } catch (const std::exception& e) {
+      ofLogError("STARTUP") << task.first << " failed: " << e.what();
+    } catch (...) {
+      ofLogError("STARTUP") << task.first << " failed";
+    }
+  }
+  startupTasks.clear();
+  logStartupPhase("audio, midi, osc");
+
+  // soak mode: EYESY_SOAK=<seconds per mode> [EYESY_SOAK_CYCLES=<count>]
+  // the default is the warm-up cycle, enough to judge, and one spare
+  const char* soak = getenv("EYESY_SOAK");
+  const char* soakCount = getenv("EYESY_SOAK_CYCLES");
+  soakInterval = soak ? ofToFloat(soak) : 0.0f;
+  soakCycles = soakCount ? ofToInt(soakCount) : MEMORY_MIN_SEGMENTS + 1 + 1;
+  soakLastSwitch = ofGetElapsedTimef();
+  if (soakInterval > 0) {
+    ofLogNotice("SOAK") << "cycling modes every " << soakInterval << "s, "
+                        << soakCycles << " cycles of " << scripts.size() << " modes, "
+                        << soakCycles * scripts.size() << " switches";
+
+    // judge memory per full pass through the modes, not per time slice
+    memoryStats.setCycleDriven(true);
+  }
+
+  // physics benchmark: EYESY_PHYSICS_BENCH=1
+  if (getenv("EYESY_PHYSICS_BENCH")) {
+    physicsBenchStage = 0;
+    physicsBenchStart = ofGetElapsedTimef();
+    physics.clear();
+  }
+
+  // clip test: EYESY_CLIP_TEST=<file>[,<file>...] [EYESY_CLIP_TEST_SECONDS=<s>]
+  if (clipTest) {
+    const char* clipSeconds = getenv("EYESY_CLIP_TEST_SECONDS");
+    for (const string& file : clipTestFiles) {
+      clipTestHandles.push_back(clips.load(file));
+    }
+    clipTestEnd = ofGetElapsedTimef() + (clipSeconds ? ofToFloat(clipSeconds) : 10.0f);
+  }
 
   // clear main screen
   ofClear(0, 0, 0);
 }
 
+//--------------------------------------------------------------
+void ofApp::setupAudio() {
+  // the full device list is slow to build, only print it when asked for
+  if (ofGetLogLevel() <= OF_LOG_VERBOSE) {
+    soundStream.printDeviceList();
+  }
+
+  ofSoundStreamSettings settings;
+
+  // device by name
+  auto devices = soundStream.getMatchingDevices("default");
+  if (!devices.empty()) {
+    settings.setInDevice(devices[0]);
+  }
+
+  settings.setInListener(this);
+  settings.sampleRate = 11025;
+  settings.numOutputChannels = 0;
+  settings.numInputChannels = 2;
+  settings.bufferSize = left.size();
+  soundStream.setup(settings);
+}
+
+//--------------------------------------------------------------
+void ofApp::logStartupPhase(const string& phase) {
+  uint64_t now = ofGetElapsedTimeMillis();
+  ofLogNotice("STARTUP") << phase << ": " << (now - lastPhaseMillis) << "ms ("
+                         << (now - startupMillis) << "ms since setup)";
+  lastPhaseMillis = now;
+}
+
 //--------------------------------------------------------------
 void ofApp::update() {
 
+  // memory accounting, once per second
+  if (memoryStats.isDue(ofGetElapsedTimef())) {
+    sampleMemory();
+  }
+
+  if (soakInterval > 0) {
+    updateSoak();
+  }
+
+  if (physicsBenchStage >= 0) {
+    updatePhysicsBench();
+  }
+
+  if (clipTestEnd > 0) {
+    updateClipTest();
+  }
+
+  // swap in the fresh mode scan once it's done, an empty scan usually
+  // means the card isn't mounted yet so keep the cached list then
+  if (modeScan.valid() &&
+      modeScan.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+    bool wasEmpty = scripts.empty();
+    string current = wasEmpty ? "" : scripts[currentScript];
+    vector<string> scanned = modeScan.get();
+    if (!scanned.empty() && (modeIndex.revalidate(scanned) || wasEmpty)) {
+      scripts = modeIndex.getPaths();
+      auto it = std::find(scripts.begin(), scripts.end(), current);
+      currentScript = it != scripts.end() ? it - scripts.begin() : 0;
+
+      // nothing was running yet, start the first mode now
+      if (wasEmpty) {
+        reloadScript();
+      }
+    }
+  }
+  updateModeIndexSave();
+
+  // no modes yet, look again every couple of seconds
+  if (scripts.empty() && !modeScan.valid() && ofGetElapsedTimef() - lastModeScan > 2.0f) {
+    lastModeScan = ofGetElapsedTimef();
+    modeScan = std::async(std::launch::async, []() { return ModeIndex::scan(MODES_DIR); });
+  }
+
   // check for waiting messages
   while (receiver.hasWaitingMessages()) {
     // get the next message
@@ -176,7 +321,7 @@ void ofApp::update() {
       midiData[7] = 0;                         // Port name (string index)
       
       // Add to message queue
-      midiMessages.push_back(midiData);
+      queueMidiMessage(midiData);
       
       // Update OSD display
       if (osdEnabled) {
@@ -186,11 +331,6 @@ void ofApp::update() {
           recentMidiNotes.erase(recentMidiNotes.begin());
         }
       }
-      
-      // Keep only recent messages to avoid memory buildup
-      if (midiMessages.size() > 100) {
-        midiMessages.erase(midiMessages.begin());
-      }
     }
     
     // Handle MIDI control change messages from Pure Data
@@ -210,29 +350,38 @@ void ofApp::update() {
       midiData[7] = 0;                         // Port name (string index)
       
       // Add to message queue
-      midiMessages.push_back(midiData);
+      queueMidiMessage(midiData);
       
       // Debug output (commented out for production)
       // ofLogNotice("OSC-MIDI") << "Received MIDI CC: control=" << control << " value=" << value;
-      
-      // Keep only recent messages to avoid memory buildup
-      if (midiMessages.size() > 100) {
-        midiMessages.erase(midiMessages.begin());
-      }
+    }
+
+    // Dump memory accounting to the log
+    if (m.getAddress() == "/stats") {
+      ofLogNotice("STATS") << "fps:" << ofToString(ofGetFrameRate(), 1) << " "
+                           << memoryStats.report();
     }
   }
 
   // Process MIDI messages and send to Lua
+  std::unique_lock<std::mutex> midiLock(midiMutex);
   if (!midiMessages.empty()) {
     // Convert first available MIDI message to Lua table
     vector<lua_Number> midiMsg = midiMessages[0];
-    lua.setNumberVector("midi_data", midiMsg);
-    lua.setBool("midi_available", true);
-
 
     // Remove processed message
     midiMessages.erase(midiMessages.begin());
+    midiLock.unlock();
+
+    lua.setNumberVector("midi_data", midiMsg);
+    lua.setBool("midi_available", true);
+
+    // note-ons can kick the physics world, see physics_drive()
+    if ((int)midiMsg[0] == MIDI_NOTE_ON) {
+      physics.driveNote(midiMsg[2], midiMsg[3]);
+    }
   } else {
+    midiLock.unlock();
     lua.setBool("midi_available", false);
   }
 
@@ -291,6 +440,13 @@ void ofApp::update() {
   // Update persist state for Lua scripts
   lua.setBool("persist", persistEnabled);
 
+  // latest body transforms for physics_buffer and physics_read
+  physics.sync();
+  physics.driveAudio(audioLevel);
+
+  // upload decoded clip frames, follows the MIDI clock for synced clips
+  clips.update(calculatedBPM);
+
   // call the script's update() function
   lua.scriptUpdate();
 }
@@ -303,7 +459,7 @@ void ofApp::draw() {
 
   // Begin persist graphics rendering if enabled
   if (persistEnabled) {
-    persistFbo.begin();
+    persistFbo->begin();
     // Clear any remaining artifacts from GPU
     if (persistFirstRender) {
       persistFirstRender = false;
@@ -313,10 +469,18 @@ void ofApp::draw() {
 
   lua.scriptDraw();
 
+  // end any target the script left bound, e.g. after an error
+  renderTargets.endAll();
+
+  // clips under test are drawn by the host, full screen
+  for (int handle : clipTestHandles) {
+    clips.draw(handle, 0, 0, ofGetWidth(), ofGetHeight());
+  }
+
   // End persist graphics rendering and draw the persisted content
   if (persistEnabled) {
-    persistFbo.end();
-    persistFbo.draw(0, 0);
+    persistFbo->end();
+    persistFbo->draw(0, 0);
   }
 
   // Draw OSD if enabled
@@ -326,7 +490,7 @@ void ofApp::draw() {
 
     // Draw semi-transparent background with increased margins
     ofSetColor(0, 0, 0, 120);
-    ofDrawRectangle(25, 25, 450, 160);
+    ofDrawRectangle(25, 25, 450, 220);
 
     ofSetColor(255, 255, 255);
     int yPos = 45;
@@ -406,6 +570,40 @@ void ofApp::draw() {
     ofDrawBitmapString(clockInfo, 35, yPos);
     yPos += 15;
 
+    // Render target pool usage
+    string poolInfo = "FBO: " + ofToString(renderTargets.getNumInUse()) + "/" +
+                      ofToString(renderTargets.getNumTargets()) + " " +
+                      ofToString(renderTargets.getGpuBytes() / (1024 * 1024)) + "MB" +
+                      " allocs:" + ofToString(renderTargets.getAllocationCount());
+    ofDrawBitmapString(poolInfo, 35, yPos);
+    yPos += 15;
+
+    // Physics worker load
+    string physicsInfo = "Bodies: " + ofToString(physics.getNumBodies()) +
+                         " step:" + ofToString(physics.getStepMillis(), 2) + "ms";
+    ofDrawBitmapString(physicsInfo, 35, yPos);
+    yPos += 15;
+
+    // Clip decode to display latency and dropped frames
+    string clipInfo = "Clips: " + ofToString(clips.getNumClips()) +
+                      " lat:" + ofToString(clips.getLatencyMillis(), 1) + "ms" +
+                      " drop:" + ofToString(clips.getDroppedFrames());
+    ofDrawBitmapString(clipInfo, 35, yPos);
+    yPos += 15;
+
+    // Memory, flagged when a subsystem keeps growing
+    if (memoryStats.getNumSamples() > 0) {
+      const MemorySample& mem = memoryStats.latest();
+      string memInfo = "Mem: " + ofToString(mem.bytes[MEMORY_PROCESS] / (1024 * 1024)) + "MB" +
+                       " lua:" + ofToString(mem.bytes[MEMORY_LUA] / 1024) + "KB";
+      vector<string> growing = memoryStats.getGrowing();
+      if (!growing.empty()) {
+        memInfo += " GROWING:" + ofJoinString(growing, ",");
+      }
+      ofDrawBitmapString(memInfo, 35, yPos);
+      yPos += 15;
+    }
+
     // Display recent MIDI notes (moved to bottom)
     for (const string& note : recentMidiNotes) {
       ofDrawBitmapString(note, 35, yPos);
@@ -421,6 +619,11 @@ void ofApp::draw() {
   // Clear MIDI clock trigger flags (they should only last one frame)
   lua.setBool("midi_beat_trigger", false);
   lua.setBool("midi_bar_trigger", false);
+
+  if (!firstFrameDrawn) {
+    firstFrameDrawn = true;
+    logStartupPhase("first frame");
+  }
 }
 
 //--------------------------------------------------------------
@@ -449,6 +652,17 @@ void ofApp::exit() {
 
   // clear the lua state
   lua.clear();
+
+  // stop the physics worker and any clip pipelines
+  physics.stop();
+  clips.releaseAll();
+
+  // keep the last known titles and load times for the next boot, after any
+  // background write has finished
+  if (modeIndexSave.valid()) {
+    modeIndexSave.wait();
+  }
+  modeIndex.saveIfDirty();
   
   // MIDI clock cleanup handled in destructor
 }
@@ -504,6 +718,10 @@ void ofApp::errorReceived(std::string &msg) {
 
 //--------------------------------------------------------------
 void ofApp::reloadScript() {
+  if (scripts.empty()) {
+    return;
+  }
+
   // exit, reinit the lua state, and reload the current script
   lua.scriptExit();
 
@@ -512,8 +730,17 @@ void ofApp::reloadScript() {
   ofSetupGraphicDefaults();
   ofSetBackgroundColor(0, 0, 0);
 
+  // hand the old script's render targets back to the pool
+  renderTargets.releaseScriptHandles();
+
+  // each mode starts with no world, the first physics_* call makes a new one
+  physics.stop();
+  physics.setDrive(0, 0);
+  clips.releaseAll();
+
   // load new
   lua.init();
+  bindHostApi();
   
   // MIDI globals are reinitialized automatically when eyesy.lua is required
   
@@ -522,11 +749,51 @@ void ofApp::reloadScript() {
     persistFirstRender = true;
   }
   
+  runScript();
+}
+
+//--------------------------------------------------------------
+void ofApp::runScript() {
+  uint64_t loadStart = ofGetElapsedTimeMicros();
+
+  // run a script
+  // true = change working directory to the script's parent dir
+  // so lua will find scripts with relative paths via require
+  // note: changing dir does *not* affect the OF data path
   lua.doScript(scripts[currentScript], true);
+
+  // call the script's setup() function
   lua.scriptSetup();
+  renderTargets.endAll();
+
+  // remember title and load time for the mode index
+  float loadMillis = (ofGetElapsedTimeMicros() - loadStart) / 1000.0f;
+  string title = lua.isString("modeTitle") ? lua.getString("modeTitle") : "";
+  // no disk write here, it would stall the mode switch, see updateModeIndexSave()
+  modeIndex.setLoaded(scripts[currentScript], title, loadMillis);
+  lastScriptSwitch = ofGetElapsedTimef();
+}
+
+//--------------------------------------------------------------
+void ofApp::updateModeIndexSave() {
+  // write the index on another thread once the modes stop changing
+  float now = ofGetElapsedTimef();
+  if (!modeIndex.isDirty() || now - lastScriptSwitch < MODE_INDEX_SAVE_DELAY ||
+      now - lastModeIndexSave < MODE_INDEX_SAVE_INTERVAL) {
+    return;
+  }
+  if (modeIndexSave.valid() &&
+      modeIndexSave.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    return;
+  }
+  lastModeIndexSave = now;
+  modeIndexSave = std::async(std::launch::async, [this]() { modeIndex.saveIfDirty(); });
 }
 
 void ofApp::nextScript() {
+  if (scripts.empty()) {
+    return;
+  }
   currentScript++;
   if (currentScript > scripts.size() - 1) {
     currentScript = 0;
@@ -535,6 +802,9 @@ void ofApp::nextScript() {
 }
 
 void ofApp::prevScript() {
+  if (scripts.empty()) {
+    return;
+  }
   if (currentScript == 0) {
     currentScript = scripts.size() - 1;
   } else {
@@ -543,12 +813,215 @@ void ofApp::prevScript() {
   reloadScript();
 }
 
+//--------------------------------------------------------------
+void ofApp::bindHostApi() {
+  // lua.init() makes a fresh state, so this runs after every init
+  renderTargets.bindLua(lua);
+  physics.bindLua(lua);
+  clips.bindLua(lua);
+}
+
+//--------------------------------------------------------------
+void ofApp::sampleMemory() {
+  MemorySample sample;
+  sample.time = ofGetElapsedTimef();
+
+  // lua heap of the current state, reloadScript() replaces it
+  lua_State* L = lua;
+  sample.bytes[MEMORY_LUA] =
+      L ? (size_t)lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0) : 0;
+
+  // pooled targets, clip textures and the snapshot image
+  sample.bytes[MEMORY_TEXTURES] = renderTargets.getGpuBytes() +
+                                  clips.getTextureBytes() +
+                                  img.getPixels().getTotalBytes();
+
+  sample.bytes[MEMORY_AUDIO] = (left.capacity() + right.capacity()) * sizeof(lua_Number);
+
+  size_t queueBytes = 0;
+  {
+    std::lock_guard<std::mutex> lock(midiMutex);
+    queueBytes += midiMessages.capacity() * sizeof(vector<lua_Number>);
+    for (const vector<lua_Number>& msg : midiMessages) {
+      queueBytes += msg.capacity() * sizeof(lua_Number);
+    }
+  }
+  for (const string& note : recentMidiNotes) {
+    queueBytes += sizeof(string) + note.capacity();
+  }
+  sample.bytes[MEMORY_QUEUES] = queueBytes;
+
+  sample.bytes[MEMORY_PROCESS] = MemoryStats::processResidentBytes();
+
+  memoryStats.record(sample);
+}
+
+//--------------------------------------------------------------
+void ofApp::updateSoak() {
+  float now = ofGetElapsedTimef();
+
+  // synthetic input through the same paths as the knobs and Pure Data
+  for (int i = 1; i <= 5; i++) {
+    lua.setNumber("knob" + ofToString(i), ofNoise(now * 0.1f, i));
+  }
+  if (ofGetFrameNum() % 15 == 0) {
+    vector<lua_Number> midiData(8, 0);
+    midiData[0] = 144;
+    midiData[2] = 36 + ofRandom(48);
+    midiData[3] = 1 + ofRandom(126);
+    midiData[6] = 129;
+    queueMidiMessage(midiData);
+  }
+  if (ofGetFrameNum() % 60 == 0) {
+    lua.setBool("trig", true);
+  }
+
+  // nothing to cycle until the modes folder shows up
+  if (now - soakLastSwitch < soakInterval || scripts.empty()) {
+    return;
+  }
+  soakLastSwitch = now;
+  nextScript();
+
+  // back at the first mode, one full cycle done
+  if (currentScript != 0) {
+    return;
+  }
+  memoryStats.endSegment();
+
+  if (--soakCycles <= 0) {
+    // non-zero exit status when anything kept growing or the run was too
+    // short to tell, for scripted runs
+    vector<string> growing = memoryStats.getGrowing();
+    bool conclusive = memoryStats.isConclusive();
+    ofLogNotice("SOAK") << "finished " << memoryStats.report();
+    if (!conclusive) {
+      ofLogWarning("SOAK") << "need " << MEMORY_MIN_SEGMENTS + 1
+                           << " full mode cycles to judge, got "
+                           << memoryStats.getNumSegments();
+    }
+    soakInterval = 0;
+    ofExit(conclusive && growing.empty() ? 0 : 1);
+  }
+}
+
+//--------------------------------------------------------------
+void ofApp::updatePhysicsBench() {
+  static const int sizes[] = {100, 1000, 5000};
+  static const int numSizes = 3;
+  static const int frames = 60;
+
+  // zero-copy ffi view, bulk read into one reused table, one call per body
+  static const string ffiView =
+      "local ffi = require('ffi')\n"
+      "for f = 1, " + ofToString(frames) + " do\n"
+      "  local p, n = physics_buffer()\n"
+      "  local t = ffi.cast('const float*', p)\n"
+      "  local s = 0\n"
+      "  for i = 0, n - 1, 4 do s = s + t[i] + t[i + 1] + t[i + 2] end\n"
+      "end\n";
+  static const string bulk =
+      "local t = physics_bench_table or {}\n"
+      "physics_bench_table = t\n"
+      "for f = 1, " + ofToString(frames) + " do\n"
+      "  local n = physics_read(t)\n"
+      "  local s = 0\n"
+      "  for i = 1, n, 4 do s = s + t[i] + t[i + 1] + t[i + 2] end\n"
+      "end\n";
+  static const string perObject =
+      "for f = 1, " + ofToString(frames) + " do\n"
+      "  local s = 0\n"
+      "  for i = 1, physics_count() do\n"
+      "    local x, y, a = physics_body(i)\n"
+      "    s = s + x + y + a\n"
+      "  end\n"
+      "end\n";
+
+  if (physicsBenchStage >= numSizes * 2) {
+    // non-zero exit status when the ffi path lost at 1k bodies or more
+    ofLogNotice("PHYSICS BENCH") << (physicsBenchFailed ? "ffi path slower" : "done");
+    physicsBenchStage = -1;
+    ofExit(physicsBenchFailed ? 1 : 0);
+    return;
+  }
+
+  int size = sizes[physicsBenchStage / 2];
+  float now = ofGetElapsedTimef();
+
+  // even stages spawn, odd stages measure once the world has settled
+  if (physicsBenchStage % 2 == 0) {
+    physics.clear();
+    physics.spawn(size, ofGetWidth() / 2, ofGetHeight() / 2, 4, ofGetHeight() * 0.45f);
+    physicsBenchStart = now;
+    physicsBenchStage++;
+    return;
+  }
+  if (physics.getNumBodies() != (size_t)size || now - physicsBenchStart < 2.0f) {
+    return;
+  }
+
+  uint64_t start = ofGetElapsedTimeMicros();
+  lua.doString(ffiView);
+  float ffiMillis = (ofGetElapsedTimeMicros() - start) / 1000.0f / frames;
+
+  start = ofGetElapsedTimeMicros();
+  lua.doString(bulk);
+  float bulkMillis = (ofGetElapsedTimeMicros() - start) / 1000.0f / frames;
+
+  start = ofGetElapsedTimeMicros();
+  lua.doString(perObject);
+  float perObjectMillis = (ofGetElapsedTimeMicros() - start) / 1000.0f / frames;
+
+  ofLogNotice("PHYSICS BENCH") << size << " bodies: step " << ofToString(physics.getStepMillis(), 2)
+                               << "ms, ffi read " << ofToString(ffiMillis, 3)
+                               << "ms/frame, bulk read " << ofToString(bulkMillis, 3)
+                               << "ms/frame, per-object read " << ofToString(perObjectMillis, 3)
+                               << "ms/frame";
+  if (size >= 1000 && ffiMillis >= perObjectMillis) {
+    physicsBenchFailed = true;
+  }
+
+  physics.clear();
+  physicsBenchStage++;
+}
+
+//--------------------------------------------------------------
+void ofApp::updateClipTest() {
+  if (ofGetElapsedTimef() < clipTestEnd) {
+    return;
+  }
+  clipTestEnd = 0.0f;
+
+  size_t decoded = clips.getDecodedFrames();
+  size_t uploaded = clips.getUploadedFrames();
+  size_t dropped = clips.getDroppedFrames();
+  float meanLatency = clips.getMeanLatencyMillis();
+  float droppedFraction = decoded > 0 ? (float)dropped / decoded : 1.0f;
+
+  bool loaded = std::find(clipTestHandles.begin(), clipTestHandles.end(), 0) == clipTestHandles.end();
+  bool passed = loaded && uploaded > 0 &&
+                meanLatency <= CLIP_TEST_MAX_LATENCY_MS &&
+                droppedFraction <= CLIP_TEST_MAX_DROPPED;
+
+  ofLogNotice("CLIP TEST") << (passed ? "passed" : "FAILED")
+                           << " clips:" << clipTestHandles.size()
+                           << (loaded ? "" : " (load failed)")
+                           << " decoded:" << decoded << " displayed:" << uploaded
+                           << " dropped:" << dropped
+                           << " latency mean:" << ofToString(meanLatency, 1)
+                           << "ms max:" << ofToString(clips.getMaxLatencyMillis(), 1) << "ms";
+  ofExit(passed ? 0 : 1);
+}
+
 //--------------------------------------------------------------
 // MIDI Implementation using ofxMidi
 //--------------------------------------------------------------
 
 void ofApp::setupMidi() {
-  midiMessages.clear();
+  {
+    std::lock_guard<std::mutex> lock(midiMutex);
+    midiMessages.clear();
+  }
 
   // Print available MIDI input ports
   // ofLogNotice("MIDI SETUP") << "Available MIDI input ports:";
@@ -630,7 +1103,7 @@ void ofApp::newMidiMessage(ofxMidiMessage &msg) {
   midiData[7] = 0;            // portName (string index, 0 for now)
 
   // Add to message queue
-  midiMessages.push_back(midiData);
+  queueMidiMessage(midiData);
 
   // Basic debug output (remove or comment out for production)
   // ofLogNotice("MIDI") << "Received MIDI message: "
@@ -639,6 +1112,13 @@ void ofApp::newMidiMessage(ofxMidiMessage &msg) {
   //                     << " ch:" << msg.channel << " pitch:" << msg.pitch
   //                     << " vel:" << msg.velocity << " ctrl:" << msg.control
   //                     << " val:" << msg.value;
+}
+
+//--------------------------------------------------------------
+void ofApp::queueMidiMessage(const vector<lua_Number>& midiData) {
+  // called from the MIDI input thread as well as update()
+  std::lock_guard<std::mutex> lock(midiMutex);
+  midiMessages.push_back(midiData);
 
   // Keep only recent messages to avoid memory buildup
   if (midiMessages.size() > 100) {
@@ -9,15 +9,26 @@
 #pragma once
 
 #include "ofMain.h"
+#include <future>
 #include "ofxLua.h"
 #include "ofxOsc.h"
 #include "ofxMidi.h"
+#include "RenderTargetPool.h"
+#include "PhysicsService.h"
+#include "ClipService.h"
+#include "MemoryStats.h"
+#include "ModeIndex.h"
 
 // Forward declaration
 class ofxMidiClock;
 
 #define PORT 4000
 #define MIDI_BUFFER_SIZE 256
+#define MODES_DIR "/sdcard/Modes/oFLua"
+#define CLIP_TEST_MAX_LATENCY_MS 50.0f
+#define CLIP_TEST_MAX_DROPPED 0.05f     // fraction of decoded frames
+#define MODE_INDEX_SAVE_DELAY 3.0f      // seconds after a mode switch before the index is written
+#define MODE_INDEX_SAVE_INTERVAL 30.0f  // and never more often than this
 
 class ofApp : public ofBaseApp, ofxLuaListener, ofxMidiListener {
 
@@ -45,6 +56,8 @@ class ofApp : public ofBaseApp, ofxLuaListener, ofxMidiListener {
         void reloadScript();
         void nextScript();
         void prevScript();
+        void runScript();
+        void bindHostApi();
     
         ofxLua lua;
         vector<string> scripts;
@@ -54,6 +67,7 @@ class ofApp : public ofBaseApp, ofxLuaListener, ofxMidiListener {
         ofxOscReceiver receiver;
 
         // audio stuff
+        void setupAudio();
         void audioIn(ofSoundBuffer & input);
     
         vector <lua_Number> left;
@@ -74,11 +88,51 @@ class ofApp : public ofBaseApp, ofxLuaListener, ofxMidiListener {
         // Persist graphics functionality
         bool                persistEnabled;
         bool                persistFirstRender;
-        ofFbo               persistFbo;
+        ofFbo*              persistFbo;
+
+        // Render targets shared by the host and scripts, survive reloads
+        RenderTargetPool    renderTargets;
+
+        // Box2D world stepped off the render thread
+        PhysicsService      physics;
+        void                updatePhysicsBench();
+        int                 physicsBenchStage;  // -1 when not benchmarking
+        float               physicsBenchStart;
+        bool                physicsBenchFailed;
+
+        // Video clips decoded by gstreamer, drawn by scripts
+        ClipService         clips;
+        void                updateClipTest();
+        vector<int>         clipTestHandles;
+        float               clipTestEnd;    // 0 when not testing
+
+        // Memory accounting and soak testing
+        MemoryStats         memoryStats;
+        void                sampleMemory();
+        void                updateSoak();
+        float               soakInterval;   // seconds per mode, 0 when off
+        int                 soakCycles;     // full passes through every mode left
+        float               soakLastSwitch;
+
+        // Startup, slow subsystems open in parallel with the first script
+        void                logStartupPhase(const string& phase);
+        vector<std::pair<string, std::future<void>>> startupTasks;  // subsystem, task
+        std::future<vector<string>> modeScan;
+        float               lastModeScan;
+        ModeIndex           modeIndex;
+        void                updateModeIndexSave();
+        std::future<void>   modeIndexSave;
+        float               lastScriptSwitch;
+        float               lastModeIndexSave;
+        uint64_t            startupMillis;
+        uint64_t            lastPhaseMillis;
+        bool                firstFrameDrawn;
 
         // MIDI functionality
         ofxMidiIn           midiIn;
         vector<vector<lua_Number>> midiMessages;
+        std::mutex          midiMutex;
+        void                queueMidiMessage(const vector<lua_Number>& midiData);
         void                newMidiMessage(ofxMidiMessage& eventArgs);
         void                setupMidi();
         